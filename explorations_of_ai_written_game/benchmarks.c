@@ -0,0 +1,1346 @@
+// BENCHMARKS
+// runs the benchmarks named on the command line, or all of them if none are named
+// the game is a single file, so it is included directly
+#include "main.c"
+#include <threads.h>
+#if defined(__unix__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+// bench seconds function
+// returns a wall clock time in seconds
+double bench_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// bench generate chunk function
+// returns the chunk generate_chunk makes at x, y, z, with terrain instead of the default one
+chunk_t bench_generate_chunk(int x, int y, int z, int seed, terrain_t *terrain) {
+    float heights[16][16];
+    generate_heights(x, y, seed, terrain, heights);
+    return generate_chunk_from_heights(x, y, z, heights);
+}
+
+// bench random float function
+// returns a random float between min and max
+float bench_random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+// svo benchmark
+// compares memory use and ray cast speed of flat chunks and sparse voxel octree chunks
+// on generated terrain chunks and on random chunks
+void benchmark_svo_corpus(char *name, chunk_t *chunks, int count) {
+    int rays = 200000;
+    svo_chunk_t *svos = malloc(sizeof(svo_chunk_t) * count);
+    long svo_bytes = 0;
+    for (int i = 0; i < count; i++) {
+        svos[i] = svo_chunk_from_chunk_t(&chunks[i]);
+        svo_bytes += svo_chunk_memory(&svos[i]);
+    }
+    float *o = malloc(sizeof(float) * 6 * rays);
+    for (int i = 0; i < rays; i++) {
+        for (int a = 0; a < 3; a++) {
+            o[i * 6 + a] = bench_random_float(0, 15.999f);
+            o[i * 6 + 3 + a] = bench_random_float(-1, 1);
+        }
+    }
+    int hit[3];
+    int flat_hits = 0;
+    int svo_hits = 0;
+    int mismatches = 0;
+    double start = bench_seconds();
+    for (int i = 0; i < rays; i++) {
+        float *r = o + i * 6;
+        flat_hits += chunk_raycast(&chunks[i % count], r[0], r[1], r[2], r[3], r[4], r[5], hit);
+    }
+    double flat_time = bench_seconds() - start;
+    start = bench_seconds();
+    for (int i = 0; i < rays; i++) {
+        float *r = o + i * 6;
+        svo_hits += svo_chunk_raycast(&svos[i % count], r[0], r[1], r[2], r[3], r[4], r[5], hit);
+    }
+    double svo_time = bench_seconds() - start;
+    for (int i = 0; i < rays; i++) {
+        float *r = o + i * 6;
+        int flat_hit[3];
+        int a = chunk_raycast(&chunks[i % count], r[0], r[1], r[2], r[3], r[4], r[5], flat_hit);
+        int b = svo_chunk_raycast(&svos[i % count], r[0], r[1], r[2], r[3], r[4], r[5], hit);
+        if (a != b || (a && (hit[0] != flat_hit[0] || hit[1] != flat_hit[1] || hit[2] != flat_hit[2]))) {
+            mismatches++;
+        }
+    }
+    printf("svo %-8s flat %6d bytes/chunk, svo %6ld bytes/chunk, flat %.2f Mrays/s, svo %.2f Mrays/s, hits %d/%d, mismatches %d\n",
+           name, (int)sizeof(chunk_t), svo_bytes / count, rays / flat_time / 1e6, rays / svo_time / 1e6, flat_hits, svo_hits, mismatches);
+    for (int i = 0; i < count; i++) {
+        svo_chunk_free(&svos[i]);
+    }
+    free(svos);
+    free(o);
+}
+
+void benchmark_svo() {
+    int count = 256;
+    chunk_t *chunks = malloc(sizeof(chunk_t) * count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = generate_chunk(i % 16, i / 16, 0, 1234);
+    }
+    benchmark_svo_corpus("terrain", chunks, count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = random_chunk();
+    }
+    benchmark_svo_corpus("random", chunks, count);
+    free(chunks);
+    // setting blocks in converted chunks, uniform ones are a single node after conversion and have to grow their pool the most
+    int zs[] = {-5, 0, 5};
+    int mismatches = 0;
+    for (int c = 0; c < 3; c++) {
+        chunk_t chunk = generate_chunk(0, 0, zs[c], 1234);
+        svo_chunk_t svo = svo_chunk_from_chunk_t(&chunk);
+        for (int i = 0; i < 4096; i++) {
+            int x = rand() % 16;
+            int y = rand() % 16;
+            int z = rand() % 16;
+            block_t block = chunk.blocks[x][y][z];
+            block.values.type = rand() % 4;
+            chunk_set_block(&chunk, x, y, z, block);
+            svo_chunk_set(&svo, x, y, z, block);
+        }
+        chunk_t back = svo_chunk_to_chunk_t(&svo);
+        mismatches += memcmp(back.blocks, chunk.blocks, sizeof(chunk.blocks)) != 0;
+        svo_chunk_free(&svo);
+    }
+    printf("svo set after convert: %d of 3 chunks differ from the flat chunk\n", mismatches);
+}
+
+// dedup benchmark
+// builds a world through the chunk store and compares its resident chunk memory with one chunk_t per position
+// then counts the distinct chunk bodies of a 1000x1000 column world (4 chunks high) from 64 bit content hashes,
+// since that world does not fit in memory without sharing
+unsigned long long bench_chunk_hash64(chunk_t *chunk) {
+    unsigned char *bytes = (unsigned char *)chunk->blocks;
+    unsigned long long hash = 14695981039346656037ull;
+    for (int i = 0; i < (int)sizeof(chunk->blocks); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void benchmark_dedup() {
+    int n = 128;
+    world_t *world = world_new(1234);
+    double start = bench_seconds();
+    for (int x = 0; x < n; x++) {
+        for (int y = 0; y < n; y++) {
+            for (int z = -2; z < 2; z++) {
+                world->generate_chunk(world, x, y, z);
+            }
+        }
+    }
+    double time = bench_seconds() - start;
+    long shared_bytes = world_chunk_memory(world);
+    long flat_bytes = (long)world->chunks.size * (sizeof(chunk_t) + sizeof(hashmap_entry_t) * 2);
+    printf("dedup world %dx%dx4: %d chunks, %d bodies, %.1f MB shared vs %.1f MB unshared (%.1f%% saved), %.2f s\n",
+           n, n, world->chunks.size, world->chunk_store.size, shared_bytes / 1e6, flat_bytes / 1e6,
+           100.0 * (flat_bytes - shared_bytes) / flat_bytes, time);
+    world->free(world);
+
+    n = 1000;
+    int capacity = 1 << 23;
+    unsigned long long *seen = calloc(capacity, sizeof(unsigned long long));
+    long chunks = 0;
+    long bodies = 0;
+    start = bench_seconds();
+    for (int x = 0; x < n; x++) {
+        for (int y = 0; y < n; y++) {
+            for (int z = -2; z < 2; z++) {
+                chunk_t chunk = generate_chunk(x, y, z, 1234);
+                unsigned long long hash = bench_chunk_hash64(&chunk) | 1;
+                int index = (int)(hash % capacity);
+                while (seen[index] != 0 && seen[index] != hash) {
+                    index = (index + 1) % capacity;
+                }
+                if (seen[index] == 0) {
+                    seen[index] = hash;
+                    bodies++;
+                }
+                chunks++;
+            }
+        }
+    }
+    time = bench_seconds() - start;
+    double unshared = chunks * (double)(sizeof(chunk_t) + sizeof(hashmap_entry_t) * 2);
+    double shared = chunks * (double)(sizeof(world_chunk_t) + sizeof(hashmap_entry_t) * 2) + bodies * (double)(sizeof(shared_chunk_t) + sizeof(hashmap_entry_t) * 2);
+    printf("dedup census %dx%dx4: %ld chunks, %ld bodies, %.2f GB shared vs %.2f GB unshared, %.2f GB saved, %.1f s\n",
+           n, n, chunks, bodies, shared / 1e9, unshared / 1e9, (unshared - shared) / 1e9, time);
+    free(seen);
+}
+
+// snapshot benchmark
+// one writer thread sets blocks and publishes every 1024 sets (one tick) while 16 reader threads pin random chunks and sum 256 of their blocks
+// compared with the same work done under one mutex shared by the writer and the readers
+#define SNAPSHOT_READERS 16
+#define SNAPSHOT_CHUNKS 256
+
+typedef struct {
+    world_t *world;
+    world_chunk_t **chunks;
+    mtx_t *lock;
+    atomic_int *stop;
+    long operations;
+    int reader;
+} snapshot_thread_t;
+
+int snapshot_reader(void *arg) {
+    snapshot_thread_t *thread = (snapshot_thread_t *)arg;
+    unsigned int random = 12345u + thread->reader;
+    long sum = 0;
+    while (!atomic_load(thread->stop)) {
+        random = random * 1103515245u + 12345u;
+        world_chunk_t *world_chunk = thread->chunks[(random >> 8) % SNAPSHOT_CHUNKS];
+        chunk_t *chunk;
+        if (thread->lock != NULL) {
+            mtx_lock(thread->lock);
+            chunk = &(world_chunk->shared->chunk);
+        }
+        else {
+            world_pin(thread->world, thread->reader);
+            chunk = world_pinned_chunk(world_chunk);
+        }
+        for (int i = 0; i < 256; i++) {
+            sum += ((block_t *)chunk->blocks)[i * 16].data;
+        }
+        if (thread->lock != NULL) {
+            mtx_unlock(thread->lock);
+        }
+        else {
+            world_unpin(thread->world, thread->reader);
+        }
+        thread->operations++;
+    }
+    return (int)(sum & 1);
+}
+
+int snapshot_writer(void *arg) {
+    snapshot_thread_t *thread = (snapshot_thread_t *)arg;
+    unsigned int random = 777u;
+    while (!atomic_load(thread->stop)) {
+        if (thread->lock != NULL) {
+            mtx_lock(thread->lock);
+        }
+        for (int i = 0; i < 1024; i++) {
+            random = random * 1103515245u + 12345u;
+            int x = (random >> 4) % (16 * 16);
+            int y = (random >> 12) % (16 * 16);
+            thread->world->set(thread->world, x, y, 4, random >> 31);
+        }
+        if (thread->lock != NULL) {
+            mtx_unlock(thread->lock);
+        }
+        else {
+            world_publish(thread->world);
+        }
+        thread->operations += 1024;
+    }
+    return 0;
+}
+
+void benchmark_snapshot_run(char *name, int locked) {
+    world_t *world = world_new(1234);
+    world_chunk_t **chunks = malloc(sizeof(world_chunk_t *) * SNAPSHOT_CHUNKS);
+    for (int i = 0; i < SNAPSHOT_CHUNKS; i++) {
+        world->generate_chunk(world, i % 16, i / 16, 0);
+        chunks[i] = world_find_chunk(world, i % 16, i / 16, 0);
+    }
+    mtx_t lock;
+    mtx_init(&lock, mtx_plain);
+    atomic_int stop;
+    atomic_init(&stop, 0);
+    snapshot_thread_t threads[SNAPSHOT_READERS + 1];
+    thrd_t ids[SNAPSHOT_READERS + 1];
+    for (int i = 0; i <= SNAPSHOT_READERS; i++) {
+        threads[i].world = world;
+        threads[i].chunks = chunks;
+        threads[i].lock = locked ? &lock : NULL;
+        threads[i].stop = &stop;
+        threads[i].operations = 0;
+        threads[i].reader = i < SNAPSHOT_READERS ? world_register_reader(world) : -1;
+        thrd_create(&ids[i], i < SNAPSHOT_READERS ? snapshot_reader : snapshot_writer, &threads[i]);
+    }
+    struct timespec duration = {1, 0};
+    thrd_sleep(&duration, NULL);
+    atomic_store(&stop, 1);
+    long reads = 0;
+    for (int i = 0; i <= SNAPSHOT_READERS; i++) {
+        thrd_join(ids[i], NULL);
+        if (i < SNAPSHOT_READERS) {
+            reads += threads[i].operations;
+        }
+    }
+    printf("snapshot %-8s 1 writer %.2f M sets/s, %d readers %.2f M chunk reads/s\n",
+           name, threads[SNAPSHOT_READERS].operations / 1e6, SNAPSHOT_READERS, reads / 1e6);
+    mtx_destroy(&lock);
+    world->free(world);
+    free(chunks);
+}
+
+void benchmark_snapshot() {
+    benchmark_snapshot_run("mutex", 1);
+    benchmark_snapshot_run("pinned", 0);
+}
+
+// rle benchmark
+// encode speed of compress_chunk_t_into with each block run length version and decode speed of decompress_chunk_t_into, in GB/s of raw blocks
+void benchmark_rle_corpus(char *name, chunk_t *chunks, int count) {
+    char *names[] = {"scalar", "sse2", "avx2"};
+    int (*kernels[])(unsigned short *, int) = {
+        block_run_length_scalar,
+#if defined(__x86_64__) || defined(_M_X64)
+        block_run_length_sse2,
+        cpu_supports_avx2() ? block_run_length_avx2 : NULL,
+#else
+        NULL,
+        NULL,
+#endif
+    };
+    int rounds = 20;
+    unsigned char *records = malloc((long)count * CHUNK_RECORD_MAX_SIZE);
+    for (int k = 0; k < 3; k++) {
+        if (kernels[k] == NULL) {
+            continue;
+        }
+        block_run_length = kernels[k];
+        long bytes = 0;
+        double start = bench_seconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) {
+                bytes += compress_chunk_t_into(&chunks[i], records + (long)i * CHUNK_RECORD_MAX_SIZE, CHUNK_RECORD_MAX_SIZE);
+            }
+        }
+        double time = bench_seconds() - start;
+        printf("rle %-8s %-6s encode %.2f GB/s, ratio %.2f\n", name, names[k],
+               (double)rounds * count * sizeof(chunks[0].blocks) / time / 1e9, (double)rounds * count * sizeof(chunks[0].blocks) / bytes);
+    }
+    chunk_t chunk;
+    double start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            decompress_chunk_t_into(records + (long)i * CHUNK_RECORD_MAX_SIZE, CHUNK_RECORD_MAX_SIZE, &chunk);
+        }
+    }
+    double time = bench_seconds() - start;
+    printf("rle %-8s decode %.2f GB/s\n", name, (double)rounds * count * sizeof(chunks[0].blocks) / time / 1e9);
+    free(records);
+    block_run_length = block_run_length_detect;
+}
+
+void benchmark_rle() {
+    int count = 1024;
+    chunk_t *chunks = malloc(sizeof(chunk_t) * count);
+    // the surface chunk, the one below it and the sky above it of every column
+    for (int i = 0; i < count; i++) {
+        chunks[i] = generate_chunk(i % 32, i / 32, (i % 3) - 1, 1234);
+    }
+    benchmark_rle_corpus("terrain", chunks, count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = random_chunk();
+    }
+    benchmark_rle_corpus("random", chunks, count);
+    free(chunks);
+}
+
+// codec benchmark
+// compares the record size and speed of every chunk codec on generated terrain and random chunks
+void benchmark_codecs_corpus(char *name, chunk_t *chunks, int count) {
+    char *names[] = {"rle", "palette"};
+    int codecs[] = {CHUNK_CODEC_RLE, CHUNK_CODEC_PALETTE_LZ};
+    int rounds = 10;
+    double raw = (double)rounds * count * sizeof(chunks[0].blocks);
+    unsigned char *records = malloc((long)count * CHUNK_RECORD_MAX_SIZE);
+    int *sizes = malloc(sizeof(int) * count);
+    for (int c = 0; c < 2; c++) {
+        long bytes = 0;
+        double start = bench_seconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) {
+                sizes[i] = compress_chunk_t_codec(&chunks[i], codecs[c], records + (long)i * CHUNK_RECORD_MAX_SIZE, CHUNK_RECORD_MAX_SIZE);
+                bytes += sizes[i];
+            }
+        }
+        double encode = bench_seconds() - start;
+        chunk_t chunk;
+        start = bench_seconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) {
+                decompress_chunk_t_into(records + (long)i * CHUNK_RECORD_MAX_SIZE, sizes[i], &chunk);
+            }
+        }
+        double decode = bench_seconds() - start;
+        printf("codec %-8s %-8s ratio %6.2f, %6.1f bytes/chunk, encode %8.1f MB/s, decode %8.1f MB/s\n", name, names[c],
+               raw / bytes, (double)bytes / rounds / count, raw / encode / 1e6, raw / decode / 1e6);
+    }
+    free(sizes);
+    free(records);
+}
+
+void benchmark_codecs() {
+    int count = 1024;
+    chunk_t *chunks = malloc(sizeof(chunk_t) * count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = generate_chunk(i % 32, i / 32, (i % 3) - 1, 1234);
+    }
+    benchmark_codecs_corpus("terrain", chunks, count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = random_chunk();
+    }
+    benchmark_codecs_corpus("random", chunks, count);
+    free(chunks);
+}
+
+// delta save benchmark
+// compares the bytes and time it takes to save a lightly edited world as full palette records and as deltas from the generated chunks
+void benchmark_delta() {
+    world_t *world = world_new(1234);
+    int side = 16;
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_get_or_generate_chunk(world, x, y, z);
+            }
+        }
+    }
+    int chunk_count = side * side * 3;
+    // edits are added on top of the ones before, so the chunks have about 1, 11, 111 and 1111 changed blocks
+    int edit_counts[] = {1, 10, 100, 1000};
+    unsigned char record[CHUNK_RECORD_MAX_SIZE];
+    for (int e = 0; e < 4; e++) {
+        for (int x = 0; x < side; x++) {
+            for (int y = 0; y < side; y++) {
+                for (int z = -1; z < 2; z++) {
+                    for (int i = 0; i < edit_counts[e]; i++) {
+                        world->set(world, x * 16 + rand() % 16, y * 16 + rand() % 16, z * 16 + rand() % 16, 2 + rand() % 8);
+                    }
+                }
+            }
+        }
+        int codecs[] = {CHUNK_CODEC_PALETTE_LZ, CHUNK_CODEC_DELTA};
+        char *names[] = {"palette", "delta"};
+        for (int c = 0; c < 2; c++) {
+            world->save_codec = codecs[c];
+            long bytes = 0;
+            double start = bench_seconds();
+            for (int i = 0; i < world->chunks.capacity; i++) {
+                world_chunk_t *world_chunk = (world_chunk_t *)world->chunks.entries[i].value;
+                if (world_chunk != NULL) {
+                    chunk_t chunk = world_chunk->shared->chunk;
+                    chunk.x = world_chunk->x;
+                    chunk.y = world_chunk->y;
+                    chunk.z = world_chunk->z;
+                    bytes += world_encode_chunk(world, &chunk, record, CHUNK_RECORD_MAX_SIZE);
+                }
+            }
+            double time = bench_seconds() - start;
+            printf("delta +%4d edits/chunk %-8s %8.1f bytes/chunk, %7.1f us/chunk\n", edit_counts[e], names[c],
+                   (double)bytes / chunk_count, time / chunk_count * 1e6);
+        }
+    }
+    world->free(world);
+}
+
+// background save benchmark
+// how long save_all_chunks holds up the calling thread when it writes the chunks itself and when it queues them on the chunk writer
+// saves into a temporary directory that is removed again
+void benchmark_save_run(char *name, char *directory, int thread_count) {
+    world_t *world = world_new(1234);
+    world->save_directory = directory;
+    int side = 16;
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_get_or_generate_chunk(world, x, y, z);
+            }
+        }
+    }
+    if (thread_count > 0) {
+        world_start_writer(world, thread_count);
+    }
+    int rounds = 5;
+    double stall = 0;
+    double start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        // a few edits in every chunk between saves
+        for (int i = 0; i < side * side * 3 * 4; i++) {
+            world->set(world, rand() % (side * 16), rand() % (side * 16), rand() % 48 - 16, 2 + rand() % 8);
+        }
+        double call = bench_seconds();
+        world->save_all_chunks(world);
+        stall += bench_seconds() - call;
+    }
+    world_save_flush(world);
+    double total = bench_seconds() - start;
+    int uring_threads = thread_count > 0 ? atomic_load(&(world->writer->uring_threads)) : 0;
+    printf("save %-12s save_all_chunks stall %7.2f ms/call, %7.2f ms until written (%d io_uring threads)\n",
+           name, stall / rounds * 1e3, total / rounds * 1e3, uring_threads);
+    char path[512];
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_chunk_file_path(world, x, y, z, path, sizeof(path));
+                remove(path);
+            }
+        }
+    }
+    world->free(world);
+}
+
+void benchmark_save() {
+#if defined(__unix__)
+    char directory[] = "/tmp/chunk_save_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return;
+    }
+    benchmark_save_run("synchronous", directory, 0);
+    benchmark_save_run("writer 1", directory, 1);
+    benchmark_save_run("writer 4", directory, 4);
+    remove(directory);
+#endif
+}
+
+// write ahead log benchmark
+// durable edits per second with an fsync after every edit and with group commits at a few intervals
+// every edit sets a random block of a 4 x 4 chunk area, the time includes waiting for the last commit
+void benchmark_wal_run(char *name, char *directory, int interval, int commit_every_edit) {
+    world_t *world = world_new(1234);
+    world->save_directory = directory;
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            world_get_or_generate_chunk(world, x, y, 0);
+        }
+    }
+    if (interval >= 0 && world_wal_open(world, interval) != 0) {
+        world->free(world);
+        return;
+    }
+    long edits = 0;
+    double start = bench_seconds();
+    while (bench_seconds() - start < 0.5) {
+        for (int i = 0; i < 64; i++) {
+            world->set(world, rand() % 64, rand() % 64, rand() % 16, 2 + (edits + i) % 8);
+            if (commit_every_edit) {
+                world_wal_commit(world);
+            }
+        }
+        edits += 64;
+    }
+    unsigned long durable = edits;
+    if (interval >= 0) {
+        world_wal_commit(world);
+        durable = world_wal_durable(world);
+    }
+    double time = bench_seconds() - start;
+    printf("wal %-16s %10.0f durable edits/s\n", name, durable / time);
+    char path[512];
+    for (int generation = 0; interval >= 0 && generation <= world->wal->generation; generation++) {
+        world_wal_path(world, generation, path, sizeof(path));
+        remove(path);
+    }
+    world->free(world);
+}
+
+void benchmark_wal() {
+#if defined(__unix__)
+    char directory[] = "/tmp/chunk_wal_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return;
+    }
+    benchmark_wal_run("no log (memory)", directory, -1, 0);
+    benchmark_wal_run("fsync every edit", directory, 0, 1);
+    benchmark_wal_run("group 1 ms", directory, 1, 0);
+    benchmark_wal_run("group 5 ms", directory, 5, 0);
+    benchmark_wal_run("group 20 ms", directory, 20, 0);
+    remove(directory);
+#endif
+}
+
+// chunk stream benchmark
+// chunks per second sent over a loopback tcp socket and decoded by a receiving thread
+// copied: every record is made with compress_chunk_t and copied into a packet buffer that is sent when full
+// iovec: chunk_stream_write sends the header, heightmap and block segments of 64 chunks in one writev, nothing is put together
+#if defined(__unix__)
+typedef struct {
+    int fd;
+    long chunks;
+    int ok;
+} stream_receiver_t;
+
+// stream receiver function
+// reads framed records until the socket is closed and decodes every one of them
+int stream_receiver(void *argument) {
+    stream_receiver_t *receiver = argument;
+    long capacity = 1 << 20;
+    unsigned char *buffer = malloc(capacity);
+    long size = 0;
+    chunk_t chunk;
+    receiver->ok = 1;
+    while (1) {
+        long got = read(receiver->fd, buffer + size, capacity - size);
+        if (got <= 0) {
+            break;
+        }
+        size += got;
+        long it = 0;
+        while (size - it >= 4) {
+            long length = ((long)buffer[it] << 24) | (buffer[it + 1] << 16) | (buffer[it + 2] << 8) | buffer[it + 3];
+            if (size - it - 4 < length) {
+                break;
+            }
+            if (decompress_chunk_t_into(buffer + it + 4, length, &chunk) != length) {
+                receiver->ok = 0;
+            }
+            receiver->chunks++;
+            it += 4 + length;
+        }
+        memmove(buffer, buffer + it, size - it);
+        size -= it;
+    }
+    free(buffer);
+    return 0;
+}
+
+void benchmark_stream_run(char *name, chunk_t *chunks, int count, int codec, int use_iovec) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t address_size = sizeof(address);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0
+        || getsockname(listener, (struct sockaddr *)&address, &address_size) != 0) {
+        printf("stream %-8s no loopback socket\n", name);
+        return;
+    }
+    int sender = socket(AF_INET, SOCK_STREAM, 0);
+    connect(sender, (struct sockaddr *)&address, sizeof(address));
+    int one = 1;
+    setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    stream_receiver_t receiver = {accept(listener, NULL, NULL), 0, 0};
+    thrd_t thread;
+    thrd_create(&thread, stream_receiver, &receiver);
+
+    int rounds = 100;
+    chunk_record_scratch_t *scratch = malloc(sizeof(chunk_record_scratch_t) * CHUNK_STREAM_BATCH);
+    unsigned char *packet = malloc((long)CHUNK_STREAM_BATCH * (4 + CHUNK_RECORD_MAX_SIZE));
+    double start = bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        if (use_iovec) {
+            chunk_stream_write(sender, chunks, count, codec, scratch);
+            continue;
+        }
+        for (int first = 0; first < count; first += CHUNK_STREAM_BATCH) {
+            long size = 0;
+            for (int i = first; i < first + CHUNK_STREAM_BATCH && i < count; i++) {
+                unsigned char *record = malloc(CHUNK_RECORD_MAX_SIZE);
+                int length = compress_chunk_t_codec(&chunks[i], codec, record, CHUNK_RECORD_MAX_SIZE);
+                record = realloc(record, length);
+                packet[size] = (length >> 24) & 0xFF;
+                packet[size + 1] = (length >> 16) & 0xFF;
+                packet[size + 2] = (length >> 8) & 0xFF;
+                packet[size + 3] = length & 0xFF;
+                memcpy(packet + size + 4, record, length);
+                size += 4 + length;
+                free(record);
+            }
+            struct iovec whole = {packet, size};
+            writev_all(sender, &whole, 1);
+        }
+    }
+    shutdown(sender, SHUT_WR);
+    thrd_join(thread, NULL);
+    double time = bench_seconds() - start;
+    printf("stream %-8s %-7s %8.0f chunks/s%s\n", name, use_iovec ? "iovec" : "copied", receiver.chunks / time,
+           receiver.ok && receiver.chunks == (long)rounds * count ? "" : " (records lost or broken)");
+    free(packet);
+    free(scratch);
+    close(sender);
+    close(receiver.fd);
+    close(listener);
+}
+#endif
+
+void benchmark_stream() {
+#if defined(__unix__)
+    int count = 256;
+    chunk_t *chunks = malloc(sizeof(chunk_t) * count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = generate_chunk(i % 16, i / 16, (i % 3) - 1, 1234);
+    }
+    benchmark_stream_run("rle", chunks, count, CHUNK_CODEC_RLE, 0);
+    benchmark_stream_run("rle", chunks, count, CHUNK_CODEC_RLE, 1);
+    benchmark_stream_run("palette", chunks, count, CHUNK_CODEC_PALETTE_LZ, 0);
+    benchmark_stream_run("palette", chunks, count, CHUNK_CODEC_PALETTE_LZ, 1);
+    free(chunks);
+#endif
+}
+
+// chunk cache benchmark
+// a random walk over a 32 x 32 chunk area, 16 block accesses per step with a few edits on the way,, once without budgets and with smaller hot and warm budgets
+// prints the hits and misses of every tier, the memory of the chunks at the end and the time per access
+void benchmark_cache_run(char *name, char *directory, long hot_budget, long warm_budget) {
+    world_t *world = world_new(1234);
+    world->save_directory = directory;
+    world->hot_budget = hot_budget;
+    world->warm_budget = warm_budget;
+    srand(1);
+    int side = 32;
+    int x = side / 2;
+    int y = side / 2;
+    long accesses = 200000;
+    double start = bench_seconds();
+    for (long i = 0; i < accesses; i++) {
+        if (i % 16 == 0) {
+            x = (x + rand() % 3 - 1 + side) % side;
+            y = (y + rand() % 3 - 1 + side) % side;
+        }
+        if (i % 64 == 0) {
+            world->set(world, x * 16 + rand() % 16, y * 16 + rand() % 16, rand() % 16, 2 + rand() % 8);
+        }
+        else {
+            world->get(world, x * 16 + rand() % 16, y * 16 + rand() % 16, rand() % 16);
+        }
+        if (i % 4096 == 0) {
+            // saving makes edited chunks clean, so they can be demoted as well, publishing lets retired bodies go
+            world->save_all_chunks(world);
+            world_publish(world);
+        }
+    }
+    double time = bench_seconds() - start;
+    printf("cache %-18s hot %6ld/%6ld  warm %6ld/%6ld  cold %6ld/%6ld hits/misses, %4d hot, %6.1f KB warm, %6.2f MB, %5.0f ns/access\n",
+           name, world->cache_hits[WORLD_TIER_HOT], world->cache_misses[WORLD_TIER_HOT],
+           world->cache_hits[WORLD_TIER_WARM], world->cache_misses[WORLD_TIER_WARM],
+           world->cache_hits[WORLD_TIER_COLD], world->cache_misses[WORLD_TIER_COLD],
+           world->hot_count, world->warm_bytes / 1e3, world_chunk_memory(world) / 1e6, time / accesses * 1e9);
+    char path[512];
+    for (int cx = 0; cx < side; cx++) {
+        for (int cy = 0; cy < side; cy++) {
+            world_chunk_file_path(world, cx, cy, 0, path, sizeof(path));
+            remove(path);
+        }
+    }
+    world->free(world);
+}
+
+void benchmark_cache() {
+#if defined(__unix__)
+    char directory[] = "/tmp/chunk_cache_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return;
+    }
+    long body = sizeof(shared_chunk_t);
+    benchmark_cache_run("unlimited", directory, 0, 0);
+    benchmark_cache_run("hot 256", directory, 256 * body, 0);
+    benchmark_cache_run("hot 64", directory, 64 * body, 0);
+    benchmark_cache_run("hot 64, warm 256 KB", directory, 64 * body, 256 * 1024);
+    benchmark_cache_run("hot 16, warm 64 KB", directory, 16 * body, 64 * 1024);
+    remove(directory);
+#endif
+}
+
+// section benchmark
+// point lookups into chunk records: decoding the whole palette+lz record against reading one block of a sectioned record in place,
+// then world_peek_block against loading the whole chunk, over cold chunk files of a few codecs
+void benchmark_sections() {
+    int count = 256;
+    unsigned char *records = malloc((long)count * CHUNK_RECORD_MAX_SIZE * 2);
+    int *sizes = malloc(sizeof(int) * count * 2);
+    long bytes[2] = {0, 0};
+    int codecs[] = {CHUNK_CODEC_PALETTE_LZ, CHUNK_CODEC_SECTIONED};
+    for (int i = 0; i < count; i++) {
+        chunk_t chunk = generate_chunk(i % 64 - 32, i / 64 - 32, 0, 1234);
+        for (int k = 0; k < 2; k++) {
+            sizes[i * 2 + k] = compress_chunk_t_codec(&chunk, codecs[k], records + (long)(i * 2 + k) * CHUNK_RECORD_MAX_SIZE, CHUNK_RECORD_MAX_SIZE);
+            bytes[k] += sizes[i * 2 + k];
+        }
+    }
+    int lookups = 200000;
+    long sum = 0;
+    for (int k = 0; k < 2; k++) {
+        srand(1);
+        double start = bench_seconds();
+        for (int n = 0; n < lookups; n++) {
+            int i = rand() % count;
+            sum += chunk_record_block(records + (long)(i * 2 + k) * CHUNK_RECORD_MAX_SIZE, sizes[i * 2 + k], rand() % 16, rand() % 16, rand() % 16);
+        }
+        double time = bench_seconds() - start;
+        printf("sections record lookup %-10s %6.1f bytes/chunk, %8.0f ns/lookup\n", k == 0 ? "palette_lz" : "sectioned",
+               (double)bytes[k] / count, time / lookups * 1e9);
+    }
+    free(sizes);
+    free(records);
+#if defined(__unix__)
+    char directory[] = "/tmp/chunk_sections_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return;
+    }
+    char *names[] = {"palette_lz", "sectioned", "delta"};
+    int save_codecs[] = {CHUNK_CODEC_PALETTE_LZ, CHUNK_CODEC_SECTIONED, CHUNK_CODEC_DELTA};
+    for (int k = 0; k < 3; k++) {
+        world_t *world = world_new(1234);
+        world->save_directory = directory;
+        world->save_codec = save_codecs[k];
+        for (int i = 0; i < 16 * 16 * 4; i++) {
+            world->set(world, rand() % 256, rand() % 256, rand() % 16, 2 + rand() % 8);
+        }
+        world->save_all_chunks(world);
+        world->free(world);
+        lookups = 20000;
+        double peek = 0;
+        double load = 0;
+        // a fresh world, so every chunk is cold
+        world = world_new(1234);
+        world->save_directory = directory;
+        for (int pass = 0; pass < 2; pass++) {
+            srand(2);
+            double start = bench_seconds();
+            for (int n = 0; n < lookups; n++) {
+                int x = rand() % 256;
+                int y = rand() % 256;
+                int z = rand() % 16;
+                if (pass == 0) {
+                    sum += world_peek_block(world, x, y, z);
+                }
+                else {
+                    // what world_get costs on a cold chunk: generating it and reading its file
+                    chunk_t chunk;
+                    world_read_chunk_file(world, x >> 4, y >> 4, 0, &chunk);
+                    sum += chunk.blocks[x & 15][y & 15][z].data;
+                }
+            }
+            *(pass == 0 ? &peek : &load) = bench_seconds() - start;
+        }
+        world->free(world);
+        printf("sections cold lookup %-10s world_peek_block %7.1f us, chunk load %7.1f us\n", names[k], peek / lookups * 1e6, load / lookups * 1e6);
+        char path[512];
+        for (int x = 0; x < 16; x++) {
+            for (int y = 0; y < 16; y++) {
+                snprintf(path, sizeof(path), "%s/chunk_%d_%d_%d.dat", directory, x, y, 0);
+                remove(path);
+            }
+        }
+    }
+    remove(directory);
+#endif
+    printf("sections checksum %ld\n", sum);
+}
+
+// archive remove chunk files function
+// removes the chunk files of the side x side x 3 chunks of the archive benchmark
+void benchmark_archive_remove(world_t *world, int side) {
+    char path[512];
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_chunk_file_path(world, x, y, z, path, sizeof(path));
+                remove(path);
+            }
+        }
+    }
+}
+
+// world archive benchmark
+// exports a 32 x 32 x 3 chunk world with a few edits per chunk into one archive and imports it again, into memory and into chunk files,
+// on 1 and 4 threads. against it, reading every chunk file of the same world one at a time, as a copy without an archive would
+void benchmark_archive() {
+#if defined(__unix__)
+    char directory[] = "/tmp/chunk_archive_XXXXXX";
+    if (mkdtemp(directory) == NULL) {
+        return;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/world.cwa", directory);
+    world_t *world = world_new(1234);
+    int side = 32;
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_get_or_generate_chunk(world, x, y, z);
+            }
+        }
+    }
+    for (int i = 0; i < side * side * 3 * 8; i++) {
+        world->set(world, rand() % (side * 16), rand() % (side * 16), rand() % 48 - 16, 2 + rand() % 8);
+    }
+    for (int threads = 1; threads <= 4; threads *= 4) {
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        double start = bench_seconds();
+        long count = world_export(world, fd, threads);
+        double export_time = bench_seconds() - start;
+        long bytes = lseek(fd, 0, SEEK_END);
+        world_t *memory = world_new(0);
+        start = bench_seconds();
+        world_import(memory, fd, threads);
+        double memory_time = bench_seconds() - start;
+        world_t *files = world_new(0);
+        files->save_directory = directory;
+        start = bench_seconds();
+        world_import(files, fd, threads);
+        double files_time = bench_seconds() - start;
+        if (threads == 1) {
+            benchmark_archive_remove(files, side);
+        }
+        printf("archive %d threads: %ld chunks, %.2f MB, export %6.1f MB/s %7.0f chunks/s, import to memory %7.0f chunks/s, to files %7.0f chunks/s\n",
+               threads, count, bytes / 1e6, bytes / export_time / 1e6, count / export_time, count / memory_time, count / files_time);
+        memory->free(memory);
+        files->free(files);
+        close(fd);
+    }
+    // the chunk files from the last import, read back one by one
+    world_t *files = world_new(1234);
+    files->save_directory = directory;
+    chunk_t chunk;
+    double start = bench_seconds();
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            for (int z = -1; z < 2; z++) {
+                world_read_chunk_file(files, x, y, z, &chunk);
+            }
+        }
+    }
+    double time = bench_seconds() - start;
+    printf("archive per chunk files: %7.0f chunks/s read\n", side * side * 3 / time);
+    benchmark_archive_remove(files, side);
+    files->free(files);
+    world->free(world);
+    snprintf(path, sizeof(path), "%s/world.cwa", directory);
+    remove(path);
+    remove(directory);
+#endif
+}
+
+// dictionary benchmark
+// trains chunk dictionaries of a few sizes on 256 chunks of a world and compresses 256 other chunks with them,
+// surface chunks and small ones (sky chunks with a few blocks set), against CHUNK_CODEC_PALETTE_LZ
+// the empty dictionary shows what comes from compressing the heightmap along with the blocks, not from the dictionary
+void benchmark_dictionary() {
+    int count = 256;
+    chunk_t *samples = malloc(sizeof(chunk_t) * count);
+    chunk_t *surface = malloc(sizeof(chunk_t) * count);
+    chunk_t *small = malloc(sizeof(chunk_t) * count);
+    for (int i = 0; i < count; i++) {
+        samples[i] = generate_chunk(i % 16, i / 16, i % 3 - 1, 1234);
+        surface[i] = generate_chunk(100 + i % 16, 50 + i / 16, 0, 1234);
+        small[i] = generate_chunk(100 + i % 16, 50 + i / 16, 2, 1234);
+        for (int k = 0; k < 1 + i % 4; k++) {
+            block_t block;
+            block.data = 2 + rand() % 8;
+            chunk_set_block(&small[i], rand() % 16, rand() % 16, rand() % 16, block);
+        }
+    }
+    unsigned char record[CHUNK_RECORD_MAX_SIZE];
+    chunk_t *corpora[] = {surface, small};
+    char *names[] = {"surface", "small"};
+    for (int c = 0; c < 2; c++) {
+        long bytes = 0;
+        for (int i = 0; i < count; i++) {
+            bytes += compress_chunk_t_codec(&corpora[c][i], CHUNK_CODEC_PALETTE_LZ, record, CHUNK_RECORD_MAX_SIZE);
+        }
+        printf("dictionary %-7s palette_lz      %6.1f bytes/chunk\n", names[c], (double)bytes / count);
+    }
+    int capacities[] = {0, 1024, 4096, 16384};
+    for (int k = 0; k < 4; k++) {
+        double start = bench_seconds();
+        chunk_dictionary_t *dictionary = chunk_dictionary_train(samples, count, capacities[k]);
+        double train = bench_seconds() - start;
+        for (int c = 0; c < 2; c++) {
+            long bytes = 0;
+            int sizes[256];
+            unsigned char *records = malloc((long)count * CHUNK_RECORD_MAX_SIZE);
+            for (int i = 0; i < count; i++) {
+                sizes[i] = compress_chunk_t_dict(&corpora[c][i], dictionary, records + (long)i * CHUNK_RECORD_MAX_SIZE, CHUNK_RECORD_MAX_SIZE);
+                bytes += sizes[i];
+            }
+            chunk_t chunk;
+            int rounds = 20;
+            start = bench_seconds();
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < count; i++) {
+                    decompress_chunk_t_dict_into(records + (long)i * CHUNK_RECORD_MAX_SIZE, sizes[i], dictionary, &chunk);
+                }
+            }
+            double decode = bench_seconds() - start;
+            printf("dictionary %-7s dict %5d bytes %6.1f bytes/chunk, decode %6.1f MB/s, trained in %.3f s\n", names[c], dictionary->size,
+                   (double)bytes / count, (double)count * rounds * sizeof(chunk.blocks) / decode / 1e6, train);
+            free(records);
+        }
+        chunk_dictionary_free(dictionary);
+    }
+    free(small);
+    free(surface);
+    free(samples);
+}
+
+// interpolation benchmark
+// the cost of a perlin_noise sample and of one blend with every noise_interpolation curve, and how far each curve is from the cosine one
+void benchmark_interpolation() {
+    char *names[] = {"cosine", "minimax", "cosine table", "smoothstep", "quintic"};
+    int samples = 200000;
+    for (int mode = NOISE_INTERPOLATION_COSINE; mode <= NOISE_INTERPOLATION_QUINTIC; mode++) {
+        noise_interpolation = mode;
+        float sum = 0;
+        double start = bench_seconds();
+        for (int i = 0; i < samples; i++) {
+            sum += perlin_noise(i * 0.37f, i * 0.11f, 0.5f, 1234);
+        }
+        double perlin = bench_seconds() - start;
+        start = bench_seconds();
+        for (int i = 0; i < samples * 10; i++) {
+            sum += interpolation_blend((i & 1023) / 1023.0f);
+        }
+        double blend = bench_seconds() - start;
+        double worst = 0;
+        for (int i = 0; i <= 1000000; i++) {
+            float t = i / 1000000.0f;
+            double error = interpolation_blend(t) - (1 - cos(t * DH_PI)) * 0.5;
+            worst = error < 0 ? (-error > worst ? -error : worst) : (error > worst ? error : worst);
+        }
+        printf("interpolation %-12s perlin_noise %6.1f ns/sample, blend %5.2f ns, max error %.2g (%g)\n",
+               names[mode], perlin / samples * 1e9, blend / samples / 10 * 1e9, worst, sum);
+    }
+    noise_interpolation = NOISE_INTERPOLATION_MINIMAX;
+}
+
+// benchmark lattice function
+// perlin noise over the 16 by 16 columns of 64 chunks, per sample with perlin_noise and per chunk with perlin_noise_grid
+// for a few sample spacings, the grid has to give the same floats
+void benchmark_lattice() {
+    float steps[] = {1, 0.25f, 0.0625f};
+    int chunks = 64;
+    float *expected = malloc(sizeof(float) * 16 * 16 * chunks);
+    float *result = malloc(sizeof(float) * 16 * 16 * chunks);
+    for (int s = 0; s < 3; s++) {
+        float step = steps[s];
+        double start = bench_seconds();
+        for (int c = 0; c < chunks; c++) {
+            for (int i = 0; i < 16; i++) {
+                for (int j = 0; j < 16; j++) {
+                    expected[c * 256 + i * 16 + j] = perlin_noise((c % 8 - 4) * 16 * step + i * step, (c / 8 - 4) * 16 * step + j * step, 0.5f, 1234);
+                }
+            }
+        }
+        double sample = bench_seconds() - start;
+        start = bench_seconds();
+        for (int c = 0; c < chunks; c++) {
+            perlin_noise_grid((c % 8 - 4) * 16 * step, (c / 8 - 4) * 16 * step, step, 16, 16, 0.5f, 1234, result + c * 256);
+        }
+        double grid = bench_seconds() - start;
+        int same = memcmp(expected, result, sizeof(float) * 16 * 16 * chunks) == 0;
+        printf("lattice step %-6g perlin_noise %7.1f us/chunk, perlin_noise_grid %6.1f us/chunk, %5.1fx, identical %s\n",
+               step, sample / chunks * 1e6, grid / chunks * 1e6, sample / grid, same ? "yes" : "no");
+    }
+    free(result);
+    free(expected);
+}
+
+// simd noise benchmark
+// samples per second of noise_batch over 64k points, smooth_noise, generate_heights and generate_chunk with each noise batch version
+// the noise of every version is compared to noise, which it has to match bit for bit
+void benchmark_simd_noise() {
+    char *names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+    void (*kernels[])(float, float, float, float *, float *, float *, float *, int, float *, int) = {
+        noise_batch_scalar,
+#if defined(__x86_64__) || defined(_M_X64)
+        cpu_supports_sse41() ? noise_batch_sse41 : NULL,
+        cpu_supports_avx2() ? noise_batch_avx2 : NULL,
+        cpu_supports_avx512() ? noise_batch_avx512 : NULL,
+#else
+        NULL,
+        NULL,
+        NULL,
+#endif
+    };
+    int count = 1 << 16;
+    float *ones = malloc(sizeof(float) * count);
+    float *x = malloc(sizeof(float) * count);
+    float *y = malloc(sizeof(float) * count);
+    float *z = malloc(sizeof(float) * count);
+    float *expected = malloc(sizeof(float) * count);
+    float *result = malloc(sizeof(float) * count);
+    for (int i = 0; i < count; i++) {
+        x[i] = (rand() % 200000 - 100000) * 0.37f;
+        y[i] = (rand() % 200000 - 100000) * 0.53f;
+        z[i] = rand() % 64 - 32;
+        ones[i] = 1;
+        expected[i] = noise(x[i], y[i], z[i], 1234);
+    }
+    for (int k = 0; k < 4; k++) {
+        if (kernels[k] == NULL) {
+            continue;
+        }
+        noise_batch = kernels[k];
+        int rounds = 100;
+        double start = bench_seconds();
+        for (int r = 0; r < rounds; r++) {
+            noise_batch(0, 0, 0, ones, x, y, z, 1234, result, count);
+        }
+        double batch = bench_seconds() - start;
+        int same = memcmp(result, expected, sizeof(float) * count) == 0;
+        float sum = 0;
+        int samples = 200000;
+        start = bench_seconds();
+        for (int i = 0; i < samples; i++) {
+            sum += smooth_noise(x[i % count], y[i % count], z[i % count], 1234);
+        }
+        double smooth = bench_seconds() - start;
+        int chunks = 4096;
+        float heights[16][16];
+        terrain_t terrain = terrain_default();
+        start = bench_seconds();
+        for (int i = 0; i < chunks; i++) {
+            generate_heights(i % 64 - 32, i / 64 - 32, 1234, &terrain, heights);
+            sum += heights[0][0];
+        }
+        double columns = bench_seconds() - start;
+        start = bench_seconds();
+        for (int i = 0; i < chunks; i++) {
+            chunk_t chunk = generate_chunk(i % 64 - 32, i / 64 - 32, 0, 1234);
+            sum += chunk.heightmap[0][0];
+        }
+        double generate = bench_seconds() - start;
+        printf("simd noise %-6s noise_batch %7.1f M/s, smooth_noise %6.2f M/s, generate_heights %6.2f M columns/s, generate_chunk %7.0f chunks/s, identical %s (%g)\n",
+               names[k], (double)rounds * count / batch / 1e6, samples / smooth / 1e6, chunks * 256.0 / columns / 1e6, chunks / generate,
+               same ? "yes" : "no", sum);
+    }
+    noise_batch = noise_batch_detect;
+    free(result);
+    free(expected);
+    free(z);
+    free(y);
+    free(x);
+    free(ones);
+}
+
+// simplex benchmark
+// samples per second of perlin_noise, simplex_noise_3d, simplex_noise_2d and the two terrain height functions,
+// and the time to generate a chunk with each terrain noise, with the 256 perlin_noise samples of a chunk's columns for comparison
+void benchmark_simplex() {
+    int samples = 400000;
+    float sum = 0;
+    double start = bench_seconds();
+    for (int i = 0; i < samples / 10; i++) {
+        sum += perlin_noise(i * 0.37f, i * 0.11f, 0.5f, 1234);
+    }
+    double perlin = bench_seconds() - start;
+    start = bench_seconds();
+    for (int i = 0; i < samples; i++) {
+        sum += simplex_noise_3d(i * 0.37f, i * 0.11f, 0.5f, 1234);
+    }
+    double simplex_3d = bench_seconds() - start;
+    start = bench_seconds();
+    for (int i = 0; i < samples; i++) {
+        sum += simplex_noise_2d(i * 0.37f, i * 0.11f, 1234);
+    }
+    double simplex_2d = bench_seconds() - start;
+    start = bench_seconds();
+    for (int i = 0; i < samples; i++) {
+        sum += plains_height_noise(i * 0.37f, i * 0.11f, 0, 1234);
+    }
+    double plains = bench_seconds() - start;
+    start = bench_seconds();
+    for (int i = 0; i < samples; i++) {
+        sum += simplex_height_noise(i * 0.37f, i * 0.11f, 1234);
+    }
+    double simplex_height = bench_seconds() - start;
+    printf("simplex perlin_noise %.2f M/s, simplex_noise_3d %.2f M/s, simplex_noise_2d %.2f M/s\n",
+           samples / 10 / perlin / 1e6, samples / simplex_3d / 1e6, samples / simplex_2d / 1e6);
+    printf("simplex plains_height_noise %.2f M/s, simplex_height_noise %.2f M/s\n", samples / plains / 1e6, samples / simplex_height / 1e6);
+
+    int chunks = 1024;
+    start = bench_seconds();
+    for (int c = 0; c < chunks / 16; c++) {
+        for (int i = 0; i < 256; i++) {
+            sum += perlin_noise((c % 8) * 16 + i / 16, (c / 8) * 16 + i % 16, 0, 1234);
+        }
+    }
+    double perlin_chunk = (bench_seconds() - start) / (chunks / 16);
+    char *names[] = {"plains", "simplex"};
+    terrain_t terrain = terrain_default();
+    for (int mode = TERRAIN_NOISE_PLAINS; mode <= TERRAIN_NOISE_SIMPLEX; mode++) {
+        terrain.noise = mode;
+        start = bench_seconds();
+        for (int c = 0; c < chunks; c++) {
+            chunk_t chunk = bench_generate_chunk(c % 32 - 16, c / 32 - 16, 0, 1234, &terrain);
+            sum += chunk.heightmap[0][0];
+        }
+        double generate = (bench_seconds() - start) / chunks;
+        printf("simplex generate_chunk %-7s %7.2f us/chunk, 256 perlin_noise columns %7.2f us/chunk (%g)\n",
+               names[mode], generate * 1e6, perlin_chunk * 1e6, sum);
+    }
+}
+
+// height cache benchmark
+// generates columns of chunks stacked 1 to 16 high into a world with and without its height cache, for both terrain noises
+void benchmark_height_cache() {
+    char *names[] = {"plains", "simplex"};
+    terrain_t terrain = terrain_default();
+    for (int mode = TERRAIN_NOISE_PLAINS; mode <= TERRAIN_NOISE_SIMPLEX; mode++) {
+        terrain.noise = mode;
+        for (int height = 1; height <= 16; height *= 4) {
+            double times[2];
+            long hits = 0;
+            for (int cached = 0; cached < 2; cached++) {
+                world_t *world = world_new(1234);
+                world_set_terrain(world, terrain);
+                if (!cached) {
+                    height_cache_free(world->height_cache);
+                    world->height_cache = NULL;
+                }
+                int columns = 4096 / height;
+                double start = bench_seconds();
+                for (int c = 0; c < columns; c++) {
+                    for (int z = 0; z < height; z++) {
+                        world_generate_chunk(world, c % 64, c / 64, z - height / 2);
+                    }
+                }
+                times[cached] = bench_seconds() - start;
+                if (cached) {
+                    hits = world->height_cache->hits;
+                }
+                world_free(world);
+            }
+            printf("height cache %-7s %2d high: %7.0f chunks/s uncached, %7.0f chunks/s cached, %.2fx, %ld hits\n",
+                   names[mode], height, 4096 / times[0], 4096 / times[1], times[0] / times[1], hits);
+        }
+    }
+}
+
+// upsample benchmark
+// chunks per second of generate_chunk at every height sample stride, for both terrain noises and upsamplings,
+// with the error of the heights against sampling every column: largest and mean difference and the share of columns whose surface block moved
+void benchmark_upsample() {
+    char *modes[] = {"plains", "simplex"};
+    char *upsamplings[] = {"bilinear", "bicubic"};
+    int chunks = 1024;
+    float (*full)[16][16] = malloc(sizeof(float) * 16 * 16 * chunks);
+    float heights[16][16];
+    terrain_t terrain = terrain_default();
+    for (int mode = TERRAIN_NOISE_PLAINS; mode <= TERRAIN_NOISE_SIMPLEX; mode++) {
+        terrain.noise = mode;
+        terrain.sample_stride = 1;
+        for (int c = 0; c < chunks; c++) {
+            generate_heights(c % 32 - 16, c / 32 - 16, 1234, &terrain, full[c]);
+        }
+        for (int upsampling = HEIGHT_UPSAMPLE_BILINEAR; upsampling <= HEIGHT_UPSAMPLE_BICUBIC; upsampling++) {
+            for (int stride = 1; stride <= 16; stride *= 2) {
+                terrain.sample_stride = stride;
+                terrain.upsample = upsampling;
+                float sum = 0;
+                double start = bench_seconds();
+                for (int c = 0; c < chunks; c++) {
+                    chunk_t chunk = bench_generate_chunk(c % 32 - 16, c / 32 - 16, 0, 1234, &terrain);
+                    sum += chunk.heightmap[0][0];
+                }
+                double generate = bench_seconds() - start;
+                double worst = 0;
+                double total = 0;
+                long moved = 0;
+                for (int c = 0; c < chunks; c++) {
+                    generate_heights(c % 32 - 16, c / 32 - 16, 1234, &terrain, heights);
+                    for (int x = 0; x < 16; x++) {
+                        for (int y = 0; y < 16; y++) {
+                            double error = heights[x][y] - full[c][x][y];
+                            error = error < 0 ? -error : error;
+                            worst = error > worst ? error : worst;
+                            total += error;
+                            moved += (int)heights[x][y] != (int)full[c][x][y];
+                        }
+                    }
+                }
+                printf("upsample %-7s %-8s stride %2d: %7.0f chunks/s, max error %5.2f, mean error %5.3f blocks, %5.1f%% surfaces moved (%g)\n",
+                       modes[mode], upsamplings[upsampling], stride, chunks / generate, worst, total / chunks / 256,
+                       100.0 * moved / chunks / 256, sum);
+            }
+        }
+    }
+    free(full);
+}
+
+// pool benchmark
+// runs per second of thread_pool_run with 1 to 4 tasks per run, the short runs where a thread of the last run can still be working
+// when the next one starts. every task counts its index, a run that did not run each index exactly once is counted as lost
+void benchmark_pool_task(void *argument, int index, int worker) {
+    (void)worker;
+    atomic_fetch_add(&(((_Atomic int *)argument)[index]), 1);
+}
+
+void benchmark_pool() {
+    int runs = 2000000;
+    thread_pool_t *pool = thread_pool_new(3);
+    _Atomic int counts[4];
+    long lost = 0;
+    double start = bench_seconds();
+    for (int r = 0; r < runs; r++) {
+        int count = 1 + r % 4;
+        for (int i = 0; i < count; i++) {
+            atomic_init(&counts[i], 0);
+        }
+        thread_pool_run(pool, benchmark_pool_task, counts, count);
+        for (int i = 0; i < count; i++) {
+            lost += atomic_load(&counts[i]) != 1;
+        }
+    }
+    double time = bench_seconds() - start;
+    printf("pool 3 threads: %.2f M runs/s, %ld tasks lost or run twice\n", runs / time / 1e6, lost);
+    thread_pool_free(pool);
+}
+
+// benchmark table
+// maps benchmark names to benchmark functions
+typedef struct {
+    char *name;
+    void (*run)();
+} benchmark_t;
+
+benchmark_t benchmarks[] = {
+    {"svo", benchmark_svo},
+    {"dedup", benchmark_dedup},
+    {"snapshot", benchmark_snapshot},
+    {"rle", benchmark_rle},
+    {"codecs", benchmark_codecs},
+    {"delta", benchmark_delta},
+    {"save", benchmark_save},
+    {"wal", benchmark_wal},
+    {"stream", benchmark_stream},
+    {"cache", benchmark_cache},
+    {"sections", benchmark_sections},
+    {"archive", benchmark_archive},
+    {"dictionary", benchmark_dictionary},
+    {"interpolation", benchmark_interpolation},
+    {"lattice", benchmark_lattice},
+    {"simd_noise", benchmark_simd_noise},
+    {"simplex", benchmark_simplex},
+    {"height_cache", benchmark_height_cache},
+    {"upsample", benchmark_upsample},
+    {"pool", benchmark_pool},
+};
+
+int main(int argc, char **argv) {
+    srand(1);
+    int count = sizeof(benchmarks) / sizeof(benchmark_t);
+    for (int i = 0; i < count; i++) {
+        int selected = argc < 2;
+        for (int j = 1; j < argc; j++) {
+            if (strcmp(argv[j], benchmarks[i].name) == 0) {
+                selected = 1;
+            }
+        }
+        if (selected) {
+            benchmarks[i].run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+// CHUNK CODEC BENCHMARK
+// runs every chunk codec over a few corpora of chunks and prints ratio, encode and decode speed as json
+// then runs the batch api over the generated corpus on 1 to 16 threads
+// every record is decoded again and compared to its chunk, the exit status is 1 if any round trip differs
+// the game is a single file, so it is included directly
+#include "main.c"
+
+// codec bench seconds function
+// returns a wall clock time in seconds
+double codec_bench_seconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// codec bench corpus data structure
+// chunks to run the codecs over, baselines holds the generated chunk of every chunk's position for CHUNK_CODEC_DELTA
+typedef struct {
+    char *name;
+    chunk_t *chunks;
+    chunk_t *baselines;
+    int count;
+} codec_bench_corpus_t;
+
+// codec bench encode function
+// writes the record of chunk i of a corpus with codec into result, returns its size or -1
+// a delta that does not fit in CHUNK_RECORD_MAX_SIZE is written with CHUNK_CODEC_PALETTE_LZ instead, as world_encode_chunk does
+int codec_bench_encode(codec_bench_corpus_t *corpus, int i, int codec, unsigned char *result) {
+    if (codec == CHUNK_CODEC_DELTA) {
+        int size = compress_chunk_t_delta(&corpus->chunks[i], &corpus->baselines[i], result, CHUNK_RECORD_MAX_SIZE);
+        if (size >= 0) {
+            return size;
+        }
+        codec = CHUNK_CODEC_PALETTE_LZ;
+    }
+    return compress_chunk_t_codec(&corpus->chunks[i], codec, result, CHUNK_RECORD_MAX_SIZE);
+}
+
+// codec bench decode function
+// reads a record of chunk i of a corpus into chunk, delta records are applied to a copy of the baseline, which is part of the timing
+int codec_bench_decode(codec_bench_corpus_t *corpus, int i, unsigned char *record, int size, chunk_t *chunk) {
+    if (chunk_record_codec(record, size) == CHUNK_CODEC_DELTA) {
+        *chunk = corpus->baselines[i];
+        return decompress_chunk_t_delta_into(record, size, chunk);
+    }
+    return decompress_chunk_t_into(record, size, chunk);
+}
+
+// codec bench run function
+// encodes and decodes a corpus with a codec for rounds rounds and prints one json object with the results
+// returns 1 if every record decoded to its chunk, blocks and heightmap
+int codec_bench_run(codec_bench_corpus_t *corpus, int codec, char *codec_name, int rounds, int first) {
+    int count = corpus->count;
+    unsigned char *records = malloc((long)count * CHUNK_RECORD_MAX_SIZE);
+    int *sizes = malloc(sizeof(int) * count);
+    long bytes = 0;
+    double start = codec_bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            sizes[i] = codec_bench_encode(corpus, i, codec, records + (long)i * CHUNK_RECORD_MAX_SIZE);
+        }
+    }
+    double encode = codec_bench_seconds() - start;
+    for (int i = 0; i < count; i++) {
+        bytes += sizes[i];
+    }
+    chunk_t chunk;
+    start = codec_bench_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            codec_bench_decode(corpus, i, records + (long)i * CHUNK_RECORD_MAX_SIZE, sizes[i], &chunk);
+        }
+    }
+    double decode = codec_bench_seconds() - start;
+    int round_trip = 1;
+    for (int i = 0; i < count; i++) {
+        int read = codec_bench_decode(corpus, i, records + (long)i * CHUNK_RECORD_MAX_SIZE, sizes[i], &chunk);
+        if (sizes[i] < 0 || read != sizes[i]
+            || memcmp(chunk.blocks, corpus->chunks[i].blocks, sizeof(chunk.blocks)) != 0
+            || memcmp(chunk.heightmap, corpus->chunks[i].heightmap, sizeof(chunk.heightmap)) != 0) {
+            round_trip = 0;
+        }
+    }
+    double raw = (double)count * sizeof(chunk.blocks);
+    printf("%s    {\"codec\": \"%s\", \"corpus\": \"%s\", \"chunks\": %d, \"raw_bytes\": %.0f, \"encoded_bytes\": %ld, \"ratio\": %.3f, "
+           "\"encode_mb_s\": %.1f, \"decode_mb_s\": %.1f, \"encode_ns_per_chunk\": %.0f, \"decode_ns_per_chunk\": %.0f, \"round_trip\": %s}",
+           first ? "" : ",\n", codec_name, corpus->name, count, raw, bytes, raw / bytes,
+           raw * rounds / encode / 1e6, raw * rounds / decode / 1e6, encode / rounds / count * 1e9, decode / rounds / count * 1e9,
+           round_trip ? "true" : "false");
+    free(sizes);
+    free(records);
+    return round_trip;
+}
+
+// codec bench batch function
+// encodes and decodes a corpus with compress_chunk_batch and decompress_chunk_batch on 1 to 16 threads and prints one json object per thread count
+// returns 1 if every chunk came back unchanged
+int codec_bench_batch(codec_bench_corpus_t *corpus, int codec, char *codec_name, int rounds, int first) {
+    int count = corpus->count;
+    chunk_t **chunks = malloc(sizeof(chunk_t *) * count);
+    chunk_t **decoded = malloc(sizeof(chunk_t *) * count);
+    chunk_t *decoded_chunks = malloc(sizeof(chunk_t) * count);
+    for (int i = 0; i < count; i++) {
+        chunks[i] = &corpus->chunks[i];
+        decoded[i] = &decoded_chunks[i];
+    }
+    int passed = 1;
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        thread_pool_t *pool = thread_pool_new(threads - 1);
+        chunk_batch_t batch;
+        double encode = 0;
+        double decode = 0;
+        int round_trip = 1;
+        for (int r = 0; r < rounds; r++) {
+            double start = codec_bench_seconds();
+            round_trip &= compress_chunk_batch(pool, chunks, count, codec, &batch) == 0;
+            encode += codec_bench_seconds() - start;
+            start = codec_bench_seconds();
+            round_trip &= decompress_chunk_batch(pool, &batch, decoded) == 0;
+            decode += codec_bench_seconds() - start;
+            if (r + 1 < rounds) {
+                chunk_batch_free(&batch);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            round_trip &= memcmp(decoded_chunks[i].blocks, corpus->chunks[i].blocks, sizeof(decoded_chunks[i].blocks)) == 0;
+        }
+        double raw = (double)count * sizeof(corpus->chunks[0].blocks);
+        printf("%s    {\"codec\": \"%s\", \"corpus\": \"%s\", \"threads\": %d, \"arena_bytes\": %ld, "
+               "\"encode_mb_s\": %.1f, \"decode_mb_s\": %.1f, \"round_trip\": %s}",
+               first && threads == 1 ? "" : ",\n", codec_name, corpus->name, threads, batch.offsets[count],
+               raw * rounds / encode / 1e6, raw * rounds / decode / 1e6, round_trip ? "true" : "false");
+        chunk_batch_free(&batch);
+        thread_pool_free(pool);
+        passed &= round_trip;
+    }
+    free(decoded_chunks);
+    free(decoded);
+    free(chunks);
+    return passed;
+}
+
+// codec bench corpus new function
+// allocates a corpus of count chunks with their baselines
+codec_bench_corpus_t codec_bench_corpus_new(char *name, int count) {
+    codec_bench_corpus_t corpus;
+    corpus.name = name;
+    corpus.count = count;
+    corpus.chunks = malloc(sizeof(chunk_t) * count);
+    corpus.baselines = malloc(sizeof(chunk_t) * count);
+    return corpus;
+}
+
+int main(int argc, char **argv) {
+    srand(1);
+    int rounds = argc > 1 ? atoi(argv[1]) : 10;
+    int seed = 1234;
+    codec_bench_corpus_t corpora[3];
+
+    // random_chunk blocks, one random type and orientation bit per block
+    corpora[0] = codec_bench_corpus_new("random", 256);
+    for (int i = 0; i < corpora[0].count; i++) {
+        corpora[0].chunks[i] = random_chunk();
+    }
+
+    // generated terrain over 8 seeds: the surface chunk, the one below it and the sky above it of 16 columns per seed
+    corpora[1] = codec_bench_corpus_new("generated", 8 * 16 * 3);
+    for (int i = 0; i < corpora[1].count; i++) {
+        corpora[1].chunks[i] = generate_chunk(i % 16, (i / 16) % 3, (i % 3) - 1, 1 + i / 48);
+    }
+
+    // uniform chunks of a single block, every type with both orientations
+    corpora[2] = codec_bench_corpus_new("uniform", 64);
+    for (int i = 0; i < corpora[2].count; i++) {
+        chunk_t *chunk = &corpora[2].chunks[i];
+        block_t block;
+        block.values.type = i / 2;
+        block.values.orientation = i % 2;
+        fill_block_run((block_t *)chunk->blocks, block, 16*16*16);
+        chunk->x = i;
+        chunk->y = 0;
+        chunk->z = 0;
+        chunk_compute_heightmap(chunk);
+    }
+
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < corpora[c].count; i++) {
+            chunk_t *chunk = &corpora[c].chunks[i];
+            corpora[c].baselines[i] = generate_chunk(chunk->x, chunk->y, chunk->z, c == 1 ? 1 + i / 48 : seed);
+        }
+    }
+
+    int codecs[] = {CHUNK_CODEC_RLE, CHUNK_CODEC_PALETTE_LZ, CHUNK_CODEC_DELTA, CHUNK_CODEC_SECTIONED};
+    char *names[] = {"rle", "palette_lz", "delta", "sectioned"};
+    int passed = 1;
+    printf("{\n  \"rounds\": %d,\n  \"results\": [\n", rounds);
+    for (int c = 0; c < 3; c++) {
+        for (int k = 0; k < 4; k++) {
+            passed &= codec_bench_run(&corpora[c], codecs[k], names[k], rounds, c == 0 && k == 0);
+        }
+    }
+    // batch encode and decode of the generated corpus, for scaling over threads
+    printf("\n  ],\n  \"batch\": [\n");
+    for (int k = 0; k < 2; k++) {
+        passed &= codec_bench_batch(&corpora[1], codecs[k], names[k], rounds, k == 0);
+    }
+    printf("\n  ],\n  \"round_trip\": %s\n}\n", passed ? "true" : "false");
+    for (int c = 0; c < 3; c++) {
+        free(corpora[c].chunks);
+        free(corpora[c].baselines);
+    }
+    return passed ? 0 : 1;
+}